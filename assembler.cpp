@@ -1,8 +1,12 @@
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 #include "parser.h"
 #include "assembler.h"
+#include "cfg.h"
 
 using namespace std;
 
@@ -12,96 +16,98 @@ int find_variable(const vector<string>& variables, const string& name) {
             return i;
         }
     }
-    cerr << "Variable not found: " << name << endl;
-    exit(1);
+    throw runtime_error("Variable not found: " + name);
 }
 
-void term_asm(term_node* term, const vector<string>& variables) {
+void term_asm(term_node* term, const vector<string>& variables, FILE* out) {
     switch (term->kind) {
     case TERM_INPUT:
-        printf("    read 0, line, LINE_MAX\n");
-        printf("    mov rdi, line\n");
-        printf("    call strlen\n");
-        printf("    mov rdi, line\n");
-        printf("    mov rsi, rax\n");
-        printf("    call parse_uint\n");
+        fprintf(out, "    read 0, line, LINE_MAX\n");
+        fprintf(out, "    mov rdi, line\n");
+        fprintf(out, "    call strlen\n");
+        fprintf(out, "    mov rdi, line\n");
+        fprintf(out, "    mov rsi, rax\n");
+        fprintf(out, "    call parse_uint\n");
         break;
     case TERM_INT:
-        printf("    mov rax, %s\n", term->value.c_str());
+        fprintf(out, "    mov rax, %s\n", term->value.c_str());
         break;
     case TERM_IDENT: {
         int index = find_variable(variables, term->value);
-        printf("    mov rax, qword [rbp - %d]\n", index * 8 + 8);
+        fprintf(out, "    mov rax, qword [rbp - %d]\n", index * 8 + 8);
         break;
     }
     }
 }
 
-void expr_asm(expr_node* expr, const vector<string>& variables) {
+void expr_asm(expr_node* expr, const vector<string>& variables, FILE* out) {
     switch (expr->kind) {
     case EXPR_TERM:
-        term_asm(get_if<term_node>(&expr->node_type), variables);
+        term_asm(get_if<term_node>(&expr->node_type), variables, out);
         break;
     case EXPR_PLUS: {
         auto bin = get_if<term_binary_node>(&expr->node_type);
-        term_asm(&bin->lhs, variables);
-        printf("    mov rdx, rax\n");
-        term_asm(&bin->rhs, variables);
-        printf("    add rax, rdx\n");
+        term_asm(&bin->lhs, variables, out);
+        fprintf(out, "    mov rdx, rax\n");
+        term_asm(&bin->rhs, variables, out);
+        fprintf(out, "    add rax, rdx\n");
         break;
     }
     }
 }
 
-void rel_asm(rel_node* rel, const vector<string>& variables) {
+void rel_asm(rel_node* rel, const vector<string>& variables, FILE* out) {
     switch (rel->kind) {
     case REL_LESS_THAN:
-        term_asm(&rel->less_than.lhs, variables);
-        printf("    mov rdx, rax\n");
-        term_asm(&rel->less_than.rhs, variables);
-        printf("    cmp rdx, rax\n");
-        printf("    setl al\n");
-        printf("    and al, 1\n");
-        printf("    movzx rax, al\n");
+        term_asm(&rel->less_than.lhs, variables, out);
+        fprintf(out, "    mov rdx, rax\n");
+        term_asm(&rel->less_than.rhs, variables, out);
+        fprintf(out, "    cmp rdx, rax\n");
+        fprintf(out, "    setl al\n");
+        fprintf(out, "    and al, 1\n");
+        fprintf(out, "    movzx rax, al\n");
         break;
     }
 }
 
-void instr_asm(instr_node* instr, vector<string>& variables, int& if_count) {
+void instr_asm(instr_node* instr, vector<string>& variables, int& if_count, const asm_options& options,
+               const if_slot_map& if_slots, FILE* out) {
     switch (instr->kind) {
     case INSTR_ASSIGN: {
         auto& a = get<assign_node>(instr->node_type);
-        expr_asm(&a.expr, variables);
+        expr_asm(&a.expr, variables, out);
         int index = find_variable(variables, a.ident);
-        printf("    mov qword [rbp - %d], rax\n", index * 8 + 8);
+        fprintf(out, "    mov qword [rbp - %d], rax\n", index * 8 + 8);
         break;
     }
     case INSTR_IF: {
         auto& if_ = get<if_node>(instr->node_type);
-        rel_asm(&if_.rel, variables);
+        rel_asm(&if_.rel, variables, out);
         int label = if_count++;
-        printf("    test rax, rax\n");
-        printf("    jz .endif%d\n", label);
-        instr_asm(if_.instr, variables, if_count);
-        printf(".endif%d:\n", label);
+        fprintf(out, "    test rax, rax\n");
+        fprintf(out, "    jz .endif%d\n", label);
+        if (options.profile)
+            fprintf(out, "    inc qword [prof_ifs + %d]\n", if_slots.at(instr) * 8);
+        instr_asm(if_.instr.get(), variables, if_count, options, if_slots, out);
+        fprintf(out, ".endif%d:\n", label);
         break;
     }
     case INSTR_GOTO: {
         auto& g = get<goto_node>(instr->node_type);
-        printf("    jmp .%s\n", g.label.c_str());
+        fprintf(out, "    jmp .%s\n", g.label.c_str());
         break;
     }
     case INSTR_OUTPUT: {
         auto& o = get<output_node>(instr->node_type);
-        term_asm(&o.term, variables);
-        printf("    mov rdi, 1\n");
-        printf("    mov rsi, rax\n");
-        printf("    call write_uint\n");
+        term_asm(&o.term, variables, out);
+        fprintf(out, "    mov rdi, 1\n");
+        fprintf(out, "    mov rsi, rax\n");
+        fprintf(out, "    call write_uint\n");
         break;
     }
     case INSTR_LABEL: {
         auto& l = get<label_node>(instr->node_type);
-        printf(".%s:\n", l.label.c_str());
+        fprintf(out, ".%s:\n", l.label.c_str());
         break;
     }
     }
@@ -113,8 +119,7 @@ void term_declare_variables(term_node* term, const vector<string>& variables) {
             if (term->value == v)
                 return;
         }
-        cerr << "Identifier not defined: " << term->value << endl;
-        exit(1);
+        throw runtime_error("Identifier not defined: " + term->value);
     }
 }
 
@@ -152,7 +157,7 @@ void instr_declare_variables(instr_node* instr, vector<string>& variables) {
     case INSTR_IF: {
         if_node& i = get<if_node>(instr->node_type);
         rel_declare_variables(&i.rel, variables);
-        instr_declare_variables(i.instr, variables);
+        instr_declare_variables(i.instr.get(), variables);
         break;
     }
     case INSTR_OUTPUT: {
@@ -167,34 +172,236 @@ void instr_declare_variables(instr_node* instr, vector<string>& variables) {
 }
 
 
-void program_asm(program_node* program) {
+// Charges the cycles since the last probe to the current block, then makes block current
+// (block < 0 only closes the running interval). Clobbers rax, rcx and rdx, which are
+// never live between instructions.
+void cycle_probe_asm(int block, FILE* out) {
+    fprintf(out, "    rdtsc\n");
+    fprintf(out, "    shl rdx, 32\n");
+    fprintf(out, "    or rax, rdx\n");
+    fprintf(out, "    mov rcx, rax\n");
+    fprintf(out, "    sub rax, qword [prof_tsc]\n");
+    fprintf(out, "    mov rdx, qword [prof_cur]\n");
+    fprintf(out, "    add qword [prof_cycles + rdx*8], rax\n");
+    fprintf(out, "    mov qword [prof_tsc], rcx\n");
+    if (block >= 0)
+        fprintf(out, "    mov qword [prof_cur], %d\n", block);
+}
+
+void block_probe_asm(int block, const asm_options& options, FILE* out) {
+    fprintf(out, "    inc qword [prof_blocks + %d]\n", block * 8);
+    if (options.profile_cycles)
+        cycle_probe_asm(block, out);
+}
+
+// open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644), write the counters, close
+void profile_dump_asm(const asm_options& options, FILE* out) {
+    if (options.profile_cycles)
+        cycle_probe_asm(-1, out);
+    fprintf(out, "    mov rax, 2\n");
+    fprintf(out, "    mov rdi, prof_path\n");
+    fprintf(out, "    mov rsi, 0x241\n");
+    fprintf(out, "    mov rdx, 420\n");
+    fprintf(out, "    syscall\n");
+    fprintf(out, "    test rax, rax\n");
+    fprintf(out, "    js .prof_done\n");
+    fprintf(out, "    mov rdi, rax\n");
+    fprintf(out, "    mov rax, 1\n");
+    fprintf(out, "    mov rsi, prof_data\n");
+    fprintf(out, "    mov rdx, prof_end - prof_data\n");
+    fprintf(out, "    syscall\n");
+    fprintf(out, "    mov rax, 3\n");
+    fprintf(out, "    syscall\n");
+    fprintf(out, ".prof_done:\n");
+}
+
+void profile_data_asm(int blocks, int ifs, const asm_options& options, FILE* out) {
+    fprintf(out, "prof_path db \"%s\", 0\n", options.profile_path.c_str());
+    fprintf(out, "align 8\n");
+    fprintf(out, "prof_data dq %d, %d, %d\n", PROFILE_MAGIC, blocks, ifs);
+    fprintf(out, "prof_blocks rq %d\n", blocks);
+    fprintf(out, "prof_ifs rq %d\n", ifs);
+    fprintf(out, "prof_cycles rq %d\n", blocks);
+    fprintf(out, "prof_end:\n");
+    fprintf(out, "prof_tsc rq 1\n");
+    fprintf(out, "prof_cur rq 1\n");
+}
+
+void instr_range_asm(program_node* program, int first, int last, const vector<int>& block_at,
+                     vector<string>& variables, int& if_count, const asm_options& options,
+                     const if_slot_map& if_slots, FILE* out) {
+    for (int i = first; i < last; i++) {
+        instr_node* instr = &program->instructions[i];
+        // probes go after a leading label so that jumps to it are counted too
+        if (block_at[i] >= 0 && instr->kind != INSTR_LABEL)
+            block_probe_asm(block_at[i], options, out);
+        instr_asm(instr, variables, if_count, options, if_slots, out);
+        if (block_at[i] >= 0 && instr->kind == INSTR_LABEL)
+            block_probe_asm(block_at[i], options, out);
+    }
+}
+
+uint64_t taken_count(const cfg& graph, const profile_data& profile, int block) {
+    const basic_block& b = graph.blocks[block];
+    if (b.branch < 0) return 0;
+    if (b.branch_if < 0) return profile.blocks[block];
+    return min(profile.ifs[b.branch_if], profile.blocks[block]);
+}
+
+// Greedy chaining: starting from the entry, keep appending the hottest not yet placed
+// successor so hot paths fall through, then append the blocks that never ran.
+vector<int> layout_order(const cfg& graph, const profile_data& profile) {
+    int count = graph.blocks.size();
+    vector<bool> placed(count, false);
+    vector<int> order;
+
+    int current = 0;
+    while (current >= 0) {
+        placed[current] = true;
+        order.push_back(current);
+
+        const basic_block& b = graph.blocks[current];
+        uint64_t taken = taken_count(graph, profile, current);
+        uint64_t fall = profile.blocks[current] - taken;
+
+        int next = -1;
+        uint64_t best = 0;
+        if (b.fallthrough >= 0 && !placed[b.fallthrough] && fall > best) {
+            next = b.fallthrough;
+            best = fall;
+        }
+        if (b.branch >= 0 && !placed[b.branch] && taken > best) {
+            next = b.branch;
+            best = taken;
+        }
+        if (next < 0) {
+            for (int i = 0; i < count; i++) {
+                if (!placed[i] && profile.blocks[i] > best) {
+                    next = i;
+                    best = profile.blocks[i];
+                }
+            }
+        }
+        current = next;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (!placed[i]) order.push_back(i);
+    }
+    return order;
+}
+
+// Lays blocks out in profile order. Every block gets a .blockN label and the exit
+// is .block<count>; missing fallthroughs become jmps, and a block ending in
+// "if rel then goto" branches directly on the compare, inverted when its target follows.
+void layout_asm(program_node* program, const cfg& graph, const profile_data& profile, const vector<int>& block_at,
+                vector<string>& variables, int& if_count, const asm_options& options,
+                const if_slot_map& if_slots, FILE* out) {
+    int count = graph.blocks.size();
+    vector<int> order = layout_order(graph, profile);
+
+    for (int k = 0; k < count; k++) {
+        int b = order[k];
+        int next = k + 1 < count ? order[k + 1] : count;
+        const basic_block& block = graph.blocks[b];
+        int fallthrough = block.exits ? count : block.fallthrough;
+
+        instr_node* tail = &program->instructions[block.last - 1];
+        // the taken counter of a profiled if needs the original lowering
+        bool fused = block.branch_if >= 0 && !options.profile
+            && get<if_node>(tail->node_type).instr->kind == INSTR_GOTO;
+
+        fprintf(out, ".block%d:\n", b);
+        instr_range_asm(program, block.first, fused ? block.last - 1 : block.last, block_at,
+                        variables, if_count, options, if_slots, out);
+
+        if (fused) {
+            auto& rel = get<if_node>(tail->node_type).rel;
+            if_count++;
+            term_asm(&rel.less_than.lhs, variables, out);
+            fprintf(out, "    mov rdx, rax\n");
+            term_asm(&rel.less_than.rhs, variables, out);
+            fprintf(out, "    cmp rdx, rax\n");
+
+            if (next == block.branch) {
+                fprintf(out, "    jge .block%d\n", fallthrough);
+            } else if (next == fallthrough) {
+                fprintf(out, "    jl .block%d\n", block.branch);
+            } else if (taken_count(graph, profile, b) * 2 > profile.blocks[b]) {
+                fprintf(out, "    jge .block%d\n", fallthrough);
+                fprintf(out, "    jmp .block%d\n", block.branch);
+            } else {
+                fprintf(out, "    jl .block%d\n", block.branch);
+                fprintf(out, "    jmp .block%d\n", fallthrough);
+            }
+        } else if (fallthrough >= 0 && next != fallthrough) {
+            fprintf(out, "    jmp .block%d\n", fallthrough);
+        }
+    }
+    fprintf(out, ".block%d:\n", count);
+}
+
+void program_asm(program_node* program, FILE* out, const asm_options& options) {
     int if_count = 0;
     vector<string> variables;
 
+    cfg graph;
+    vector<int> block_at(program->instructions.size(), -1);
+    if (options.profile || options.layout_profile) {
+        build_cfg(program, &graph);
+    }
+    // taken counters are indexed like cfg::ifs (source order), whatever order the ifs are emitted in
+    if_slot_map if_slots;
+    if (options.profile) {
+        for (int b = 0; b < (int)graph.blocks.size(); b++) {
+            block_at[graph.blocks[b].first] = b;
+        }
+        for (int i = 0; i < (int)graph.ifs.size(); i++) {
+            if_slots[graph.ifs[i]] = i;
+        }
+    }
+
+    const profile_data* layout = nullptr;
+    if (options.layout_profile && graph.valid && !graph.blocks.empty()) {
+        layout = options.layout_profile;
+        if (layout->blocks.size() != graph.blocks.size() || layout->ifs.size() != graph.ifs.size())
+            throw runtime_error("Profile does not match the program");
+    }
+
     for (int i = 0; i < program->instructions.size(); i++) {
         instr_node* instr = &program->instructions[i];
         instr_declare_variables(instr, variables);
     }
 
-    printf("format ELF64 executable\n");
-    printf("LINE_MAX equ 1024\n");
-    printf("segment readable executable\n");
-    printf("include \"linux.inc\"\n");
-    printf("include \"utils.inc\"\n");
-    printf("entry _start\n");
-    printf("_start:\n");
+    fprintf(out, "format ELF64 executable\n");
+    fprintf(out, "LINE_MAX equ 1024\n");
+    fprintf(out, "segment readable executable\n");
+    fprintf(out, "include \"linux.inc\"\n");
+    fprintf(out, "include \"utils.inc\"\n");
+    fprintf(out, "entry _start\n");
+    fprintf(out, "_start:\n");
 
-    printf("    mov rbp, rsp\n");
-    printf("    sub rsp, %d\n", static_cast<int>(variables.size()) * 8);
+    fprintf(out, "    mov rbp, rsp\n");
+    fprintf(out, "    sub rsp, %d\n", static_cast<int>(variables.size()) * 8);
+    if (options.profile_cycles) {
+        fprintf(out, "    rdtsc\n");
+        fprintf(out, "    shl rdx, 32\n");
+        fprintf(out, "    or rax, rdx\n");
+        fprintf(out, "    mov qword [prof_tsc], rax\n");
+    }
 
-    for (int i = 0; i < program->instructions.size(); i++) {
-        instr_node* instr = &program->instructions[i];
-        instr_asm(instr, variables, if_count);
-    }
-    printf("    add rsp, %d\n", static_cast<int>(variables.size()) * 8);
-    printf("    mov rax, 60\n");
-    printf("    xor rdi, rdi\n");
-    printf("    syscall\n");
-    printf("segment readable writeable\n");
-    printf("line rb LINE_MAX\n");
+    if (layout)
+        layout_asm(program, graph, *layout, block_at, variables, if_count, options, if_slots, out);
+    else
+        instr_range_asm(program, 0, program->instructions.size(), block_at, variables, if_count, options, if_slots, out);
+    if (options.profile)
+        profile_dump_asm(options, out);
+    fprintf(out, "    add rsp, %d\n", static_cast<int>(variables.size()) * 8);
+    fprintf(out, "    mov rax, 60\n");
+    fprintf(out, "    xor rdi, rdi\n");
+    fprintf(out, "    syscall\n");
+    fprintf(out, "segment readable writeable\n");
+    if (options.profile)
+        profile_data_asm(graph.blocks.size(), graph.ifs.size(), options, out);
+    fprintf(out, "line rb LINE_MAX\n");
 }
@@ -1,18 +1,32 @@
 #pragma once
+#include <cstdio>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include "parser.h"
+#include "profile.h"
 
 using namespace std;
 
 
-void program_asm(program_node* program);
+struct asm_options {
+    bool profile = false;           // count basic block entries and taken ifs, dump them at exit
+    bool profile_cycles = false;    // also accumulate rdtsc cycles spent in each basic block
+    string profile_path = DEFAULT_PROFILE_PATH;
+    const profile_data* layout_profile = nullptr;  // order blocks by these counts instead of source order
+};
 
+void program_asm(program_node* program, FILE* out = stdout, const asm_options& options = asm_options());
 
-void instr_asm(instr_node* instr, vector<string>& variables, int& if_count);
-void expr_asm(expr_node* expr, const vector<string>& variables);
-void term_asm(term_node* term, const vector<string>& variables);
-void rel_asm(rel_node* rel, const vector<string>& variables);
+
+// Slot of each if in the taken counters of a --profile build (its index in cfg::ifs)
+typedef unordered_map<const instr_node*, int> if_slot_map;
+
+void instr_asm(instr_node* instr, vector<string>& variables, int& if_count, const asm_options& options,
+               const if_slot_map& if_slots, FILE* out);
+void expr_asm(expr_node* expr, const vector<string>& variables, FILE* out);
+void term_asm(term_node* term, const vector<string>& variables, FILE* out);
+void rel_asm(rel_node* rel, const vector<string>& variables, FILE* out);
 
 
 void instr_declare_variables(instr_node* instr, vector<string>& variables);
@@ -0,0 +1,86 @@
+#include <map>
+#include "cfg.h"
+
+using namespace std;
+
+// Returns the goto executed by instr, looking through if bodies, or nullptr
+goto_node* instr_branch(instr_node* instr) {
+    switch (instr->kind) {
+    case INSTR_GOTO:
+        return &get<goto_node>(instr->node_type);
+    case INSTR_IF:
+        return instr_branch(get<if_node>(instr->node_type).instr.get());
+    default:
+        return nullptr;
+    }
+}
+
+static void collect_ifs(instr_node* instr, cfg* graph) {
+    if (instr->kind != INSTR_IF) return;
+    auto& if_ = get<if_node>(instr->node_type);
+    graph->ifs.push_back(instr);
+    if (if_.instr->kind == INSTR_LABEL) graph->valid = false;
+    collect_ifs(if_.instr.get(), graph);
+}
+
+void build_cfg(program_node* program, cfg* graph) {
+    graph->blocks.clear();
+    graph->ifs.clear();
+    graph->valid = true;
+
+    map<string, int> labels;
+    vector<int> top_if;     // index in graph->ifs of each top-level if, -1 otherwise
+    int size = program->instructions.size();
+
+    for (int i = 0; i < size; i++) {
+        instr_node* instr = &program->instructions[i];
+        top_if.push_back(instr->kind == INSTR_IF ? (int)graph->ifs.size() : -1);
+        collect_ifs(instr, graph);
+
+        bool starts = i == 0 || instr->kind == INSTR_LABEL
+            || instr_branch(&program->instructions[i - 1]) != nullptr;
+        if (starts) {
+            basic_block block;
+            block.first = i;
+            block.branch = -1;
+            block.fallthrough = -1;
+            block.exits = false;
+            block.branch_if = -1;
+            graph->blocks.push_back(block);
+        }
+        graph->blocks.back().last = i + 1;
+
+        if (instr->kind == INSTR_LABEL) {
+            labels.emplace(get<label_node>(instr->node_type).label, graph->blocks.size() - 1);
+        }
+    }
+
+    int count = graph->blocks.size();
+    for (int b = 0; b < count; b++) {
+        basic_block& block = graph->blocks[b];
+        instr_node* tail = &program->instructions[block.last - 1];
+        goto_node* g = instr_branch(tail);
+
+        if (g) {
+            auto target = labels.find(g->label);
+            if (target == labels.end()) {
+                graph->valid = false;
+            } else {
+                block.branch = target->second;
+                block.branch_if = top_if[block.last - 1];
+            }
+        }
+        if (!g || tail->kind == INSTR_IF) {
+            if (b + 1 < count) block.fallthrough = b + 1;
+            else block.exits = true;
+        }
+    }
+
+    for (int b = 0; b < count; b++) {
+        basic_block& block = graph->blocks[b];
+        if (block.branch >= 0) graph->blocks[block.branch].preds.push_back(b);
+        if (block.fallthrough >= 0 && block.fallthrough != block.branch) {
+            graph->blocks[block.fallthrough].preds.push_back(b);
+        }
+    }
+}
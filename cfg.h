@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "parser.h"
+
+using namespace std;
+
+// A basic block is a run of top-level instructions entered only at its first
+// instruction (program start or a label) and left only after its last one
+// (a goto, an if whose body is a goto, or the start of the next block).
+struct basic_block {
+    int first;              // index of the first instruction in program->instructions
+    int last;               // one past the last instruction
+    int branch;             // block targeted by the goto ending this block, -1 if none
+    int fallthrough;        // block reached by falling off the end, -1 if none
+    bool exits;             // falling off the end leaves the program
+    int branch_if;          // index in cfg::ifs of the if guarding the goto, -1 for a plain goto
+    vector<int> preds;
+};
+
+struct cfg {
+    vector<basic_block> blocks;
+    vector<instr_node*> ifs;    // every if (nested ones included) in the order instr_asm numbers them
+    bool valid;                 // false when a label is hidden in an if body or a goto has no target
+};
+
+goto_node* instr_branch(instr_node* instr);
+void build_cfg(program_node* program, cfg* graph);
@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "profile.h"
+#include "socket_io.h"
+
+using namespace std;
+
+// Thin client for compile_server: reads the program from stdin like ./main, takes
+// the same compile options and prints the assembly. With --bench N it instead
+// measures N round trips, and with --oneshot PATH it measures N fresh runs of the
+// one-shot compiler (given the same options) for comparison.
+
+string read_input() {
+    ostringstream ss;
+    ss << cin.rdbuf();
+    return ss.str();
+}
+
+// Request layout as documented in server.cpp; the profile named by --profile-use is
+// sent along since the server cannot be expected to see the client's files
+bool build_request(const vector<string>& options, const string& source, string& message) {
+    string header, profile;
+    int count = 0;
+    for (const auto& option : options) {
+        if (option.compare(0, 14, "--profile-use=") == 0) {
+            string error;
+            if (!read_profile_file(option.substr(14), profile, error)) {
+                cerr << error << endl;
+                return false;
+            }
+            header += "--profile-bytes=" + to_string(profile.size()) + "\n";
+        } else {
+            header += option + "\n";
+        }
+        count++;
+    }
+    message = "options " + to_string(count) + "\n" + header + profile + source;
+    return true;
+}
+
+bool request(const string& path, const string& source, string& reply) {
+    int fd = connect_unix(path);
+    if (fd < 0) {
+        cerr << "Cannot connect to " << path << ": " << strerror(errno) << endl;
+        return false;
+    }
+    bool sent = write_all(fd, source.data(), source.size());
+    int send_errno = errno;
+    shutdown(fd, SHUT_WR);
+    reply.clear();
+    bool received = read_all(fd, reply);
+    int receive_errno = errno;
+    close(fd);
+
+    if (sent && received) return true;
+    // the server rejects a source before reading all of it and then closes the
+    // connection, so sending or reading may fail after its error reply arrived
+    if (reply.compare(0, 6, "error\n") == 0) return true;
+
+    if (!sent) cerr << "Cannot send source to " << path << ": " << strerror(send_errno) << endl;
+    else cerr << "Cannot read reply from " << path << ": " << strerror(receive_errno) << endl;
+    return false;
+}
+
+bool run_oneshot(const string& compiler, const vector<string>& options, const string& source) {
+    int fds[2];
+    if (pipe(fds) < 0) return false;
+
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        int devnull = open("/dev/null", O_WRONLY);
+        dup2(fds[0], STDIN_FILENO);
+        dup2(devnull, STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        vector<char*> argv = {const_cast<char*>(compiler.c_str())};
+        for (const auto& option : options) argv.push_back(const_cast<char*>(option.c_str()));
+        argv.push_back(nullptr);
+        execv(compiler.c_str(), argv.data());
+        _exit(127);
+    }
+
+    close(fds[0]);
+    bool ok = write(fds[1], source.data(), source.size()) == (ssize_t)source.size();
+    close(fds[1]);
+
+    int status;
+    waitpid(pid, &status, 0);
+    return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int bench(const string& path, const string& compiler, const vector<string>& options, const string& source,
+          const string& message, int count) {
+    vector<double> latencies;
+    string reply;
+
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+        auto t0 = chrono::steady_clock::now();
+        bool ok = compiler.empty() ? request(path, message, reply) : run_oneshot(compiler, options, source);
+        auto t1 = chrono::steady_clock::now();
+        if (!ok) {
+            cerr << "Request " << i << " failed\n";
+            return 1;
+        }
+        latencies.push_back(chrono::duration<double, micro>(t1 - t0).count());
+    }
+    double total = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    sort(latencies.begin(), latencies.end());
+    size_t p50 = latencies.size() / 2;
+    size_t p99 = min(latencies.size() - 1, latencies.size() * 99 / 100);
+    printf("%s: %d requests in %.3f s\n", compiler.empty() ? "server" : "one-shot", count, total);
+    printf("  requests/s: %.1f\n", count / total);
+    printf("  p50 latency: %.1f us\n", latencies[p50]);
+    printf("  p99 latency: %.1f us\n", latencies[p99]);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    string path = DEFAULT_SOCKET_PATH;
+    string compiler;
+    int count = 0;
+    vector<string> options;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            path = argv[++i];
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--oneshot") == 0 && i + 1 < argc) {
+            compiler = argv[++i];
+        } else if (strcmp(argv[i], "-S") == 0) {
+            // the server only ever sends the assembly
+        } else if (argv[i][0] == '-') {
+            options.push_back(argv[i]);
+        } else {
+            cerr << "usage: " << argv[0] << " [-s socket_path] [--bench N [--oneshot ./main]] [./main options] < source\n";
+            return 1;
+        }
+    }
+
+    string source = read_input();
+    string message;
+    if (!build_request(options, source, message)) return 1;
+    if (count > 0) {
+        return bench(path, compiler, options, source, message, count);
+    }
+
+    string reply;
+    if (!request(path, message, reply)) return 1;
+
+    size_t newline = reply.find('\n');
+    string status = reply.substr(0, newline);
+    string body = newline == string::npos ? "" : reply.substr(newline + 1);
+    if (status.compare(0, 3, "ok ") != 0) {
+        cerr << body;
+        return 1;
+    }
+    size_t diagnostics = min<size_t>(strtoull(status.c_str() + 3, nullptr, 10), body.size());
+    cerr << body.substr(0, diagnostics);
+    fwrite(body.data() + diagnostics, 1, body.size() - diagnostics, stdout);
+    return 0;
+}
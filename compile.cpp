@@ -0,0 +1,85 @@
+#include <cstdlib>
+#include <stdexcept>
+#include "compile.h"
+#include "parser.h"
+#include "assembler.h"
+#include "optimizer.h"
+
+using namespace std;
+
+static bool has_prefix(const string& arg, const char* prefix, string* value) {
+    size_t size = char_traits<char>::length(prefix);
+    if (arg.compare(0, size, prefix) != 0) return false;
+    *value = arg.substr(size);
+    return true;
+}
+
+bool parse_compile_option(const string& arg, compile_options* options, bool* stats, string& error) {
+    string value;
+    if (arg == "-O0") {
+        options->cse = false;
+    } else if (arg == "--stats") {
+        *stats = true;
+    } else if (arg == "--profile") {
+        options->codegen.profile = true;
+    } else if (arg == "--profile-cycles") {
+        options->codegen.profile = true;
+        options->codegen.profile_cycles = true;
+    } else if (has_prefix(arg, "--profile-out=", &value)) {
+        if (value.empty() || value.find_first_of("\"\n") != string::npos) {
+            error = "Invalid profile path: " + value;
+            return false;
+        }
+        options->codegen.profile_path = value;
+    } else if (has_prefix(arg, "--max-errors=", &value)) {
+        options->limits.max_errors = strtoul(value.c_str(), nullptr, 10);
+    } else if (has_prefix(arg, "--max-nodes=", &value)) {
+        options->limits.max_nodes = strtoull(value.c_str(), nullptr, 10);
+    } else if (has_prefix(arg, "--max-memory=", &value)) {
+        options->limits.max_memory = strtoull(value.c_str(), nullptr, 10);
+    } else {
+        error = "Unknown option " + arg;
+        return false;
+    }
+    return true;
+}
+
+void lex_source(const string& source, vector<Token>& tokens) {
+    Lexer lexer(source);
+    tokens.clear();
+
+    Token tok;
+    do{
+        tok = lexer.next_token();
+        tokens.push_back(tok);
+    }while (tok.kind != TokenKind::END);
+}
+
+bool compile_source(const string& source, const compile_options& options, vector<Token>& tokens, FILE* out, string& error,
+                    compile_stats* stats) {
+    lex_source(source, tokens);
+
+    struct parser p;
+    struct program_node program;
+    parser_init(tokens, &p, options.limits);
+    if (!parse_program(&p, &program)) {
+        error.clear();
+        for (const auto& e : p.errors) {
+            if (!error.empty()) error += "\n";
+            error += e;
+        }
+        return false;
+    }
+    if (options.cse) {
+        int eliminated = eliminate_common_subexpressions(&program);
+        if (stats) stats->cse_eliminated = eliminated;
+    }
+
+    try {
+        program_asm(&program, out, options.codegen);
+    } catch (const exception& e) {
+        error = e.what();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "lexer.h"
+#include "parser.h"
+#include "assembler.h"
+
+using namespace std;
+
+struct compile_options {
+    bool cse = true;        // run eliminate_common_subexpressions before program_asm
+    asm_options codegen;
+    parser_limits limits;
+};
+
+struct compile_stats {
+    int cse_eliminated = 0;
+};
+
+// Applies one ./main command-line option to options (--stats sets *stats). Everything
+// but --profile-use is handled here, since its profile has to be loaded by the caller.
+// Returns false and fills error for unknown or invalid options.
+bool parse_compile_option(const string& arg, compile_options* options, bool* stats, string& error);
+
+// Lexes the whole source into tokens, including the trailing END token.
+// The vector is cleared first so callers can reuse its capacity between compiles.
+void lex_source(const string& source, vector<Token>& tokens);
+
+// Runs the Lexer -> parse_program -> program_asm pipeline and writes the assembly to out.
+// Returns false and fills error (all diagnostics, one per line) if the program could not be compiled.
+bool compile_source(const string& source, const compile_options& options, vector<Token>& tokens, FILE* out, string& error,
+                    compile_stats* stats = nullptr);
@@ -0,0 +1,334 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#include "kinds.h"
+
+// Header-only compile-time front end: lexes and parses a program held in a
+// string_view during C++ constant evaluation and turns it into a specialized
+// function of the host program, so embedded programs cost nothing at startup.
+//
+//     struct counter {
+//         static constexpr std::string_view text = "i = 0\n:loop\noutput i\ni = i + 1\nif i < 10 then goto :loop";
+//     };
+//     ct::compiled<counter>::run([] { return int64_t(0); }, [](int64_t v) { printf("%ld\n", (long)v); });
+//
+// Errors that ./main reports at runtime (unexpected tokens, undefined identifiers,
+// unknown labels) make the constant evaluation fail, i.e. are compile errors here.
+// Labels inside if bodies are not supported.
+
+namespace ct {
+
+constexpr size_t max_instrs = 256;
+constexpr size_t max_vars = 64;
+
+inline void fail(const char* message) {
+    throw std::logic_error(message);
+}
+
+constexpr bool is_space(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v'; }
+constexpr bool is_digit(char c) { return c >= '0' && c <= '9'; }
+constexpr bool is_ident(char c) { return is_digit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+
+struct token {
+    TokenKind kind = TokenKind::END;
+    std::string_view value;
+};
+
+// Same token rules as Lexer::next_token
+struct lexer {
+    std::string_view buffer;
+    size_t pos = 0;
+
+    constexpr explicit lexer(std::string_view input) : buffer(input) {}
+
+    constexpr char peek() const { return pos < buffer.size() ? buffer[pos] : '\0'; }
+
+    constexpr std::string_view read_while(bool (*pred)(char)) {
+        size_t start = pos;
+        while (pos < buffer.size() && pred(buffer[pos])) pos++;
+        return buffer.substr(start, pos - start);
+    }
+
+    constexpr token next_token() {
+        while (is_space(peek())) pos++;
+
+        char c = peek();
+        if (c == '\0') return {TokenKind::END, {}};
+
+        if (c == '=') { pos++; return {TokenKind::EQUAL, {}}; }
+        if (c == '+') { pos++; return {TokenKind::PLUS, {}}; }
+        if (c == '<') { pos++; return {TokenKind::LESS_THAN, {}}; }
+
+        if (c == ':') {
+            pos++;
+            return {TokenKind::LABEL, read_while(is_ident)};
+        }
+
+        if (is_digit(c)) return {TokenKind::INT, read_while(is_digit)};
+
+        if (is_ident(c)) {
+            std::string_view ident = read_while(is_ident);
+            if (ident == "input") return {TokenKind::INPUT, {}};
+            if (ident == "output") return {TokenKind::OUTPUT, {}};
+            if (ident == "goto") return {TokenKind::GOTO, {}};
+            if (ident == "if") return {TokenKind::IF, {}};
+            if (ident == "then") return {TokenKind::THEN, {}};
+            return {TokenKind::IDENT, ident};
+        }
+
+        pos++;
+        return {TokenKind::INVALID, buffer.substr(pos - 1, 1)};
+    }
+};
+
+struct term {
+    term_kind kind = TERM_INT;
+    int64_t value = 0;      // TERM_INT
+    int var = -1;           // TERM_IDENT, slot in program::vars
+};
+
+// Flattened instr_node: operands live inline, if bodies in program::bodies
+struct instr {
+    instr_kind kind = INSTR_LABEL;
+    expr_kind expr = EXPR_TERM;     // INSTR_ASSIGN
+    int var = -1;                   // INSTR_ASSIGN target slot
+    term lhs;                       // expression, rel or output operand
+    term rhs;
+    std::string_view label;         // INSTR_GOTO / INSTR_LABEL
+    size_t target = 0;              // INSTR_GOTO, index of the label in program::instrs
+    size_t body = 0;                // INSTR_IF, index in program::bodies
+};
+
+struct program {
+    instr instrs[max_instrs];
+    size_t count = 0;
+    instr bodies[max_instrs];
+    size_t body_count = 0;
+    std::string_view vars[max_vars];
+    size_t var_count = 0;
+};
+
+struct parser {
+    lexer lex;
+    token current;
+    program* prog;
+
+    constexpr parser(std::string_view source, program* p) : lex(source), current(), prog(p) {
+        current = lex.next_token();
+    }
+
+    constexpr void advance() { current = lex.next_token(); }
+
+    constexpr token expect(TokenKind kind, const char* message) {
+        if (current.kind != kind) fail(message);
+        token t = current;
+        advance();
+        return t;
+    }
+
+    // Identifiers must be assigned before they are used, as in instr_declare_variables
+    constexpr int find_var(std::string_view name) const {
+        for (size_t i = 0; i < prog->var_count; i++) {
+            if (prog->vars[i] == name) return i;
+        }
+        return -1;
+    }
+
+    constexpr int declare_var(std::string_view name) {
+        int index = find_var(name);
+        if (index >= 0) return index;
+        if (prog->var_count == max_vars) fail("too many variables");
+        prog->vars[prog->var_count] = name;
+        return prog->var_count++;
+    }
+
+    constexpr term parse_term() {
+        term t;
+        if (current.kind == TokenKind::INPUT) {
+            t.kind = TERM_INPUT;
+        } else if (current.kind == TokenKind::INT) {
+            t.kind = TERM_INT;
+            for (char c : current.value) {
+                if (t.value > (INT64_MAX - (c - '0')) / 10) fail("integer literal out of range");
+                t.value = t.value * 10 + (c - '0');
+            }
+        } else if (current.kind == TokenKind::IDENT) {
+            t.kind = TERM_IDENT;
+            t.var = find_var(current.value);
+            if (t.var < 0) fail("identifier not defined");
+        } else {
+            fail("expected int, input or ident");
+        }
+        advance();
+        return t;
+    }
+
+    constexpr instr parse_instr() {
+        instr in;
+        switch (current.kind) {
+        case TokenKind::IDENT: {
+            std::string_view name = current.value;
+            advance();
+            expect(TokenKind::EQUAL, "expected equal");
+            in.kind = INSTR_ASSIGN;
+            in.lhs = parse_term();
+            if (current.kind == TokenKind::PLUS) {
+                advance();
+                in.expr = EXPR_PLUS;
+                in.rhs = parse_term();
+            }
+            in.var = declare_var(name);
+            break;
+        }
+        case TokenKind::IF: {
+            advance();
+            in.kind = INSTR_IF;
+            in.lhs = parse_term();
+            expect(TokenKind::LESS_THAN, "expected rel (<)");
+            in.rhs = parse_term();
+            expect(TokenKind::THEN, "expected 'then'");
+            if (current.kind == TokenKind::LABEL) fail("labels inside if bodies are not supported");
+            instr body = parse_instr();
+            if (prog->body_count == max_instrs) fail("too many if instructions");
+            in.body = prog->body_count++;
+            prog->bodies[in.body] = body;
+            break;
+        }
+        case TokenKind::GOTO:
+            advance();
+            in.kind = INSTR_GOTO;
+            in.label = expect(TokenKind::LABEL, "expected label").value;
+            break;
+        case TokenKind::OUTPUT:
+            advance();
+            in.kind = INSTR_OUTPUT;
+            in.lhs = parse_term();
+            break;
+        case TokenKind::LABEL:
+            in.kind = INSTR_LABEL;
+            in.label = current.value;
+            advance();
+            break;
+        default:
+            fail("unexpected token");
+        }
+        return in;
+    }
+
+    constexpr size_t find_label(std::string_view label) const {
+        for (size_t i = 0; i < prog->count; i++) {
+            if (prog->instrs[i].kind == INSTR_LABEL && prog->instrs[i].label == label) return i;
+        }
+        fail("goto to an undefined label");
+        return 0;
+    }
+
+    constexpr void resolve(instr& in) const {
+        if (in.kind == INSTR_GOTO) in.target = find_label(in.label);
+    }
+
+    constexpr void parse_program() {
+        while (current.kind != TokenKind::END) {
+            if (prog->count == max_instrs) fail("too many instructions");
+            instr in = parse_instr();
+            prog->instrs[prog->count++] = in;
+        }
+        for (size_t i = 0; i < prog->count; i++) resolve(prog->instrs[i]);
+        for (size_t i = 0; i < prog->body_count; i++) resolve(prog->bodies[i]);
+    }
+};
+
+constexpr program parse(std::string_view source) {
+    program prog;
+    parser p(source, &prog);
+    p.parse_program();
+    return prog;
+}
+
+// Source is any type with a `static constexpr std::string_view text`. Every
+// instruction becomes its own template instance with its operands baked in,
+// straight-line code falls through from one to the next and only gotos go back
+// through the dispatch on the program counter.
+template <class Source>
+struct compiled {
+    static constexpr program ast = parse(Source::text);
+    static constexpr size_t no_jump = ~size_t(0);
+
+    template <class In, class Out>
+    struct state {
+        int64_t vars[ast.var_count ? ast.var_count : 1];
+        In& input;
+        Out& output;
+    };
+
+    template <bool Body, size_t I>
+    static constexpr instr at() {
+        if constexpr (Body) return ast.bodies[I];
+        else return ast.instrs[I];
+    }
+
+    template <class St>
+    static int64_t eval(const term& t, St& st) {
+        switch (t.kind) {
+        case TERM_INPUT: return st.input();
+        case TERM_INT: return t.value;
+        case TERM_IDENT: return st.vars[t.var];
+        }
+        return 0;
+    }
+
+    // Runs one instruction, returns the goto target or no_jump
+    template <bool Body, size_t I, class St>
+    static size_t exec_one(St& st) {
+        constexpr instr in = at<Body, I>();
+        if constexpr (in.kind == INSTR_ASSIGN) {
+            int64_t value = eval(in.lhs, st);
+            if constexpr (in.expr == EXPR_PLUS)
+                value = int64_t(uint64_t(value) + uint64_t(eval(in.rhs, st)));
+            st.vars[in.var] = value;
+        } else if constexpr (in.kind == INSTR_IF) {
+            int64_t lhs = eval(in.lhs, st);
+            if (lhs < eval(in.rhs, st)) return exec_one<true, in.body>(st);
+        } else if constexpr (in.kind == INSTR_GOTO) {
+            return in.target;
+        } else if constexpr (in.kind == INSTR_OUTPUT) {
+            st.output(eval(in.lhs, st));
+        }
+        return no_jump;
+    }
+
+    template <size_t I, class St>
+    static size_t exec_from(St& st) {
+        if constexpr (I >= ast.count) {
+            return ast.count;
+        } else {
+            size_t jump = exec_one<false, I>(st);
+            if (jump != no_jump) return jump;
+            return exec_from<I + 1>(st);
+        }
+    }
+
+    template <class St, size_t... Is>
+    static size_t dispatch(size_t pc, St& st, std::index_sequence<Is...>) {
+        size_t next = ast.count;
+        ((pc == Is ? (next = exec_from<Is>(st), true) : false) || ...);
+        return next;
+    }
+
+    // input() returns the next value read by `input`, output(v) receives every `output`
+    template <class In, class Out>
+    static void run(In&& input, Out&& output) {
+        state<In, Out> st{{}, input, output};
+        size_t pc = 0;
+        while (pc < ast.count) {
+            pc = dispatch(pc, st, std::make_index_sequence<ast.count>());
+        }
+    }
+};
+
+} // namespace ct
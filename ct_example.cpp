@@ -0,0 +1,46 @@
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "ct_compiler.h"
+
+using namespace std;
+
+// Programs compiled by ct_compiler.h at C++ compile time. Built with every make so
+// that changes to kinds.h or the grammar keep the header compiling; exits with 1
+// if a program produces unexpected output.
+
+struct counter {
+    static constexpr std::string_view text = "i = 0\n:loop\noutput i\ni = i + 1\nif i < 10 then goto :loop";
+};
+
+struct nested_if {
+    static constexpr std::string_view text = R"(n = input
+i = 0
+:loop
+i = i + 1
+if i < n then if 2 < i then goto :done
+goto :loop
+:done
+output i)";
+};
+
+template <class Source>
+bool check(const char* name, vector<int64_t> inputs, const vector<int64_t>& expected) {
+    vector<int64_t> outputs;
+    size_t next = 0;
+    ct::compiled<Source>::run(
+        [&] { return next < inputs.size() ? inputs[next++] : int64_t(0); },
+        [&](int64_t v) { outputs.push_back(v); });
+
+    bool ok = outputs == expected;
+    printf("%s:", name);
+    for (int64_t v : outputs) printf(" %lld", (long long)v);
+    printf("%s\n", ok ? "" : "  (unexpected)");
+    return ok;
+}
+
+int main() {
+    bool ok = check<counter>("counter", {}, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9});
+    ok = check<nested_if>("nested_if", {10}, {3}) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,198 @@
+#include <cstring>
+#include <vector>
+#include "jit.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+using namespace std;
+
+#if defined(__x86_64__) && defined(__linux__)
+
+// Register use: rbx holds the variable array, r12 the rt_io, [rsp] is a spill
+// slot for the left operand when the right one calls rt_input.
+
+struct jit_buffer {
+    vector<uint8_t> code;
+    vector<int> offsets;                    // code offset of each instruction from start
+    vector<pair<size_t, int>> patches;      // rel32 position, target instruction
+};
+
+static void emit(jit_buffer* b, initializer_list<uint8_t> bytes) {
+    b->code.insert(b->code.end(), bytes);
+}
+
+static void emit32(jit_buffer* b, uint32_t value) {
+    for (int i = 0; i < 4; i++) b->code.push_back(value >> (i * 8));
+}
+
+static void emit64(jit_buffer* b, uint64_t value) {
+    for (int i = 0; i < 8; i++) b->code.push_back(value >> (i * 8));
+}
+
+// add rsp, 8; pop r12; pop rbx; ret
+static void emit_epilogue(jit_buffer* b) {
+    emit(b, {0x48, 0x83, 0xC4, 0x08, 0x41, 0x5C, 0x5B, 0xC3});
+}
+
+// Leaves the region, the interpreter continues at pc
+static void emit_exit(jit_buffer* b, int pc) {
+    emit(b, {0xB8});                    // mov eax, pc
+    emit32(b, pc);
+    emit_epilogue(b);
+}
+
+// mov rax, imm64; call rax
+static void emit_call(jit_buffer* b, const void* function) {
+    emit(b, {0x48, 0xB8});
+    emit64(b, reinterpret_cast<uint64_t>(function));
+    emit(b, {0xFF, 0xD0});
+}
+
+static void emit_term(jit_buffer* b, const rt_term& term) {
+    switch (term.kind) {
+    case TERM_INPUT:
+        emit(b, {0x4C, 0x89, 0xE7});    // mov rdi, r12
+        emit_call(b, reinterpret_cast<const void*>(&rt_input));
+        break;
+    case TERM_INT:
+        if (term.value >= INT32_MIN && term.value <= INT32_MAX) {
+            emit(b, {0x48, 0xC7, 0xC0});    // mov rax, imm32
+            emit32(b, term.value);
+        } else {
+            emit(b, {0x48, 0xB8});          // mov rax, imm64
+            emit64(b, term.value);
+        }
+        break;
+    case TERM_IDENT:
+        emit(b, {0x48, 0x8B, 0x83});    // mov rax, [rbx + disp32]
+        emit32(b, term.var * 8);
+        break;
+    }
+}
+
+// Leaves lhs in rdx and rhs in rax, like term_asm followed by "mov rdx, rax"
+static void emit_operands(jit_buffer* b, const rt_term& lhs, const rt_term& rhs) {
+    emit_term(b, lhs);
+    if (rhs.kind == TERM_INPUT) {
+        emit(b, {0x48, 0x89, 0x04, 0x24});  // mov [rsp], rax
+        emit_term(b, rhs);
+        emit(b, {0x48, 0x8B, 0x14, 0x24});  // mov rdx, [rsp]
+    } else {
+        emit(b, {0x48, 0x89, 0xC2});        // mov rdx, rax
+        emit_term(b, rhs);
+    }
+}
+
+// Jumps to target: a rel32 patched later when it is inside the region, an exit otherwise
+static void emit_jump(jit_buffer* b, int start, int target, initializer_list<uint8_t> opcode) {
+    if (target >= start) {
+        emit(b, opcode);
+        b->patches.push_back({b->code.size(), target});
+        emit32(b, 0);
+    } else if (opcode.size() == 1) {
+        emit_exit(b, target);
+    } else {
+        // conditional exit: skip over the exit stub when the condition fails
+        vector<uint8_t> inverted(opcode);
+        inverted.back() ^= 1;               // jl <-> jge
+        emit(b, {inverted[0], inverted[1]});
+        size_t skip = b->code.size();
+        emit32(b, 0);
+        emit_exit(b, target);
+        uint32_t distance = b->code.size() - (skip + 4);
+        memcpy(&b->code[skip], &distance, 4);
+    }
+}
+
+static void emit_instr(jit_buffer* b, const rt_program& program, int start, const rt_instr& instr) {
+    switch (instr.kind) {
+    case INSTR_ASSIGN:
+        if (instr.expr == EXPR_PLUS) {
+            emit_operands(b, instr.lhs, instr.rhs);
+            emit(b, {0x48, 0x01, 0xD0});    // add rax, rdx
+        } else {
+            emit_term(b, instr.lhs);
+        }
+        emit(b, {0x48, 0x89, 0x83});        // mov [rbx + disp32], rax
+        emit32(b, instr.var * 8);
+        break;
+    case INSTR_IF: {
+        const rt_instr& body = program.bodies[instr.body];
+        emit_operands(b, instr.lhs, instr.rhs);
+        emit(b, {0x48, 0x39, 0xC2});        // cmp rdx, rax
+        if (body.kind == INSTR_GOTO) {
+            emit_jump(b, start, body.target, {0x0F, 0x8C});    // jl
+            break;
+        }
+        emit(b, {0x0F, 0x8D});              // jge over the body
+        size_t skip = b->code.size();
+        emit32(b, 0);
+        emit_instr(b, program, start, body);
+        uint32_t distance = b->code.size() - (skip + 4);
+        memcpy(&b->code[skip], &distance, 4);
+        break;
+    }
+    case INSTR_GOTO:
+        emit_jump(b, start, instr.target, {0xE9});
+        break;
+    case INSTR_OUTPUT:
+        emit_term(b, instr.lhs);
+        emit(b, {0x48, 0x89, 0xC6});        // mov rsi, rax
+        emit(b, {0x4C, 0x89, 0xE7});        // mov rdi, r12
+        emit_call(b, reinterpret_cast<const void*>(&rt_output));
+        break;
+    case INSTR_LABEL:
+        break;
+    }
+}
+
+bool jit_compile(const rt_program& program, int start, jit_region* region) {
+    jit_buffer b;
+    int count = program.instrs.size();
+
+    // push rbx; push r12; sub rsp, 8; mov rbx, rdi; mov r12, rsi
+    emit(&b, {0x53, 0x41, 0x54, 0x48, 0x83, 0xEC, 0x08, 0x48, 0x89, 0xFB, 0x49, 0x89, 0xF4});
+
+    for (int pc = start; pc < count; pc++) {
+        b.offsets.push_back(b.code.size());
+        emit_instr(&b, program, start, program.instrs[pc]);
+    }
+    emit_exit(&b, count);
+
+    for (const auto& patch : b.patches) {
+        uint32_t distance = b.offsets[patch.second - start] - (patch.first + 4);
+        memcpy(&b.code[patch.first], &distance, 4);
+    }
+
+    void* memory = mmap(nullptr, b.code.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return false;
+    memcpy(memory, b.code.data(), b.code.size());
+    if (mprotect(memory, b.code.size(), PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, b.code.size());
+        return false;
+    }
+
+    region->entry = reinterpret_cast<native_fn>(memory);
+    region->memory = memory;
+    region->size = b.code.size();
+    return true;
+}
+
+void jit_free(jit_region* region) {
+    if (region->memory) munmap(region->memory, region->size);
+    region->memory = nullptr;
+    region->entry = nullptr;
+}
+
+#else
+
+bool jit_compile(const rt_program&, int, jit_region*) {
+    return false;
+}
+
+void jit_free(jit_region*) {
+}
+
+#endif
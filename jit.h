@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "runtime.h"
+
+// A compiled region takes the variable array and the rt_io, runs until control
+// leaves the region and returns the index of the next instruction to interpret.
+typedef int64_t (*native_fn)(int64_t* vars, rt_io* io);
+
+struct jit_region {
+    native_fn entry;
+    void* memory;
+    size_t size;
+};
+
+// Compiles program->instrs[start..] into executable memory. Returns false where
+// native code is not supported (not x86-64 Linux) or memory cannot be mapped.
+bool jit_compile(const rt_program& program, int start, jit_region* region);
+void jit_free(jit_region* region);
@@ -0,0 +1,44 @@
+#pragma once
+
+// Kinds shared by the runtime compiler (lexer.h, parser.h) and the constexpr
+// front end in ct_compiler.h.
+
+// Token kinds
+enum class TokenKind {
+    IDENT,
+    LABEL,
+    INT,
+    INPUT,
+    OUTPUT,
+    GOTO,
+    IF,
+    THEN,
+    EQUAL,
+    PLUS,
+    LESS_THAN,
+    INVALID,
+    END
+};
+
+enum term_kind { 
+    TERM_INPUT, 
+    TERM_INT, 
+    TERM_IDENT 
+};
+
+enum instr_kind { 
+    INSTR_ASSIGN, 
+    INSTR_IF, 
+    INSTR_GOTO, 
+    INSTR_OUTPUT, 
+    INSTR_LABEL 
+};
+
+enum expr_kind { 
+    EXPR_TERM, 
+    EXPR_PLUS 
+};
+
+enum rel_kind {
+    REL_LESS_THAN 
+};
@@ -4,13 +4,20 @@
 #include <sstream>
 
 Lexer::Lexer(const std::string& input)
-    : buffer(input), pos(0), read_pos(0), ch(0) {
+    : buffer(input), pos(0), read_pos(0), ch(0), line(1) {
     read_char();
 }
 
 Token Lexer::next_token() {
     skip_whitespace();
 
+    int token_line = line;
+    Token token = read_token();
+    token.line = token_line;
+    return token;
+}
+
+Token Lexer::read_token() {
     if (ch == '\0') return {TokenKind::END, ""};
 
     if (ch == '=') { read_char(); return {TokenKind::EQUAL, ""}; }
@@ -43,6 +50,7 @@ Token Lexer::next_token() {
 }
 
 void Lexer::read_char() {
+    if (ch == '\n') line++;
     if (read_pos >= buffer.size()) {
         ch = '\0';
     } else {
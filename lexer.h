@@ -3,26 +3,12 @@
 #include <string>
 #include <vector>
 
-// Token kinds
-enum class TokenKind {
-    IDENT,
-    LABEL,
-    INT,
-    INPUT,
-    OUTPUT,
-    GOTO,
-    IF,
-    THEN,
-    EQUAL,
-    PLUS,
-    LESS_THAN,
-    INVALID,
-    END
-};
+#include "kinds.h"
 
 struct Token {
     TokenKind kind;
     std::string value;
+    int line = 0;
 };
 
 std::string show_token_kind(TokenKind kind);
@@ -38,7 +24,9 @@ private:
     size_t pos;
     size_t read_pos;
     char ch;
+    int line;
 
+    Token read_token();
     void read_char();
     void skip_whitespace();
     std::string read_identifier();
@@ -1,8 +1,13 @@
 #include "lexer.h"
 #include "parser.h"
 #include "assembler.h"
+#include "compile.h"
+#include "optimizer.h"
 #include <iostream>
 #include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
 #include <vector>
 
 using namespace std;
@@ -13,30 +18,64 @@ string read_input() {
     return ss.str();
 }
 
-int main() {
+int main(int argc, char** argv) {
+    compile_options options;
+    profile_data layout_profile;
+    bool stats = false;
+    bool dump = true;           // token list and AST before the assembly
+
+    for (int i = 1; i < argc; i++) {
+        string error;
+        if (strcmp(argv[i], "-S") == 0) {
+            dump = false;
+        } else if (strncmp(argv[i], "--profile-use=", 14) == 0) {
+            if (!load_profile(argv[i] + 14, &layout_profile, error)) {
+                cerr << error << endl;
+                return 1;
+            }
+            options.codegen.layout_profile = &layout_profile;
+        } else if (!parse_compile_option(argv[i], &options, &stats, error)) {
+            cerr << error << endl;
+            cerr << "usage: " << argv[0] << " [-S] [-O0] [--stats] [--profile | --profile-cycles] [--profile-out=PATH]"
+                 << " [--profile-use=PATH] [--max-errors=N] [--max-nodes=N] [--max-memory=BYTES] < source\n";
+            return 1;
+        }
+    }
+
     string input = read_input();
-    Lexer lexer(input);
     vector<Token> tokens;
+    lex_source(input, tokens);
 
-    Token tok;
-    do{
-        tok = lexer.next_token();
-        tokens.push_back(tok);
-    }while (tok.kind != TokenKind::END);
-
-    cout << tokens.size() << "\n";
-    for (const auto& t : tokens) {
-        print_token(t);
+    if (dump) {
+        cout << tokens.size() << "\n";
+        for (const auto& t : tokens) {
+            print_token(t);
+        }
+        cout<<"\n\n --------------PARSER-----------\n";
     }
-    cout<<"\n\n --------------PARSER-----------\n";
     struct parser p;
     struct program_node program;
-    parser_init(tokens,&p);
+    parser_init(tokens, &p, options.limits);
 
-    parse_program(&p, &program);
+    if (!parse_program(&p, &program)) {
+        for (const auto& error : p.errors) {
+            cerr << error << endl;
+        }
+        return 1;
+    }
+
+    if (dump) print_program(&program);
 
-    print_program(&program);
+    if (options.cse) {
+        int eliminated = eliminate_common_subexpressions(&program);
+        if (stats) cerr << "cse: " << eliminated << " expressions eliminated\n";
+    }
 
-    program_asm(&program);
+    try {
+        program_asm(&program, stdout, options.codegen);
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
     return 0;
 }
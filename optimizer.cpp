@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "cfg.h"
+#include "optimizer.h"
+
+using namespace std;
+
+// "holder currently equals lhs + rhs", operands are variable names or literals
+struct available_sum {
+    string holder;
+    string key;
+    string lhs;
+    string rhs;
+
+    bool operator<(const available_sum& other) const {
+        if (holder != other.holder) return holder < other.holder;
+        return key < other.key;
+    }
+
+    bool operator==(const available_sum& other) const {
+        return holder == other.holder && key == other.key;
+    }
+};
+
+typedef set<available_sum> sum_set;
+
+static string term_key(const term_node& term) {
+    return (term.kind == TERM_INT ? "#" : "$") + term.value;
+}
+
+// Fills fact for a sum that can be reused, input reads never can
+static bool expr_sum(expr_node* expr, available_sum* fact) {
+    if (expr->kind != EXPR_PLUS) return false;
+    auto& bin = get<term_binary_node>(expr->node_type);
+    if (bin.lhs.kind == TERM_INPUT || bin.rhs.kind == TERM_INPUT) return false;
+
+    string lhs = term_key(bin.lhs), rhs = term_key(bin.rhs);
+    if (rhs < lhs) swap(lhs, rhs);
+    fact->key = lhs + "+" + rhs;
+    fact->lhs = bin.lhs.kind == TERM_IDENT ? bin.lhs.value : "";
+    fact->rhs = bin.rhs.kind == TERM_IDENT ? bin.rhs.value : "";
+    return true;
+}
+
+static void kill_variable(sum_set& sums, const string& ident) {
+    for (auto it = sums.begin(); it != sums.end();) {
+        if (it->holder == ident || it->lhs == ident || it->rhs == ident) it = sums.erase(it);
+        else ++it;
+    }
+}
+
+static sum_set intersect(const sum_set& a, const sum_set& b) {
+    sum_set result;
+    set_intersection(a.begin(), a.end(), b.begin(), b.end(), inserter(result, result.begin()));
+    return result;
+}
+
+// Index of the top-level instruction that first assigns each variable; program_asm
+// declares variables in source order, so a copy may only read one declared earlier
+static void collect_declarations(instr_node* instr, int index, map<string, int>& declared) {
+    if (instr->kind == INSTR_ASSIGN)
+        declared.emplace(get<assign_node>(instr->node_type).ident, index);
+    else if (instr->kind == INSTR_IF)
+        collect_declarations(get<if_node>(instr->node_type).instr.get(), index, declared);
+}
+
+// Applies instr (top-level instruction index) to sums; when declared is given,
+// reusable sums held by an already declared variable are replaced by copies
+static void transfer(instr_node* instr, int index, sum_set& sums, const map<string, int>* declared, int& eliminated) {
+    switch (instr->kind) {
+    case INSTR_ASSIGN: {
+        auto& a = get<assign_node>(instr->node_type);
+        available_sum fact;
+        bool is_sum = expr_sum(&a.expr, &fact);
+
+        if (is_sum && declared) {
+            for (const auto& s : sums) {
+                if (s.key != fact.key) continue;
+                auto holder = declared->find(s.holder);
+                if (holder == declared->end() || holder->second >= index) continue;
+                term_node copy;
+                copy.kind = TERM_IDENT;
+                copy.value = s.holder;
+                a.expr.kind = EXPR_TERM;
+                a.expr.node_type = copy;
+                eliminated++;
+                break;
+            }
+        }
+
+        kill_variable(sums, a.ident);
+        if (is_sum && fact.lhs != a.ident && fact.rhs != a.ident) {
+            fact.holder = a.ident;
+            sums.insert(fact);
+        }
+        break;
+    }
+    case INSTR_IF: {
+        // the body may or may not run, so only what survives both ways stays available
+        sum_set taken = sums;
+        transfer(get<if_node>(instr->node_type).instr.get(), index, taken, declared, eliminated);
+        sums = intersect(sums, taken);
+        break;
+    }
+    case INSTR_GOTO:
+    case INSTR_OUTPUT:
+    case INSTR_LABEL:
+        break;
+    }
+}
+
+static void block_transfer(program_node* program, const basic_block& block, sum_set& sums,
+                           const map<string, int>* declared, int& eliminated) {
+    for (int i = block.first; i < block.last; i++) {
+        transfer(&program->instructions[i], i, sums, declared, eliminated);
+    }
+}
+
+int eliminate_common_subexpressions(program_node* program) {
+    cfg graph;
+    build_cfg(program, &graph);
+    if (!graph.valid || graph.blocks.empty()) return 0;
+
+    int count = graph.blocks.size();
+    vector<sum_set> in(count), out(count);
+    vector<bool> reached(count, false);     // unreached blocks stand for "every sum" in the meet
+    reached[0] = true;
+
+    int unused = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int b = 0; b < count; b++) {
+            // the program start reaches block 0 with nothing available
+            sum_set entry;
+            bool any = b == 0;
+            if (b != 0) {
+                for (int pred : graph.blocks[b].preds) {
+                    if (!reached[pred]) continue;
+                    entry = any ? intersect(entry, out[pred]) : out[pred];
+                    any = true;
+                }
+            }
+            if (!any) continue;
+
+            sum_set exit = entry;
+            block_transfer(program, graph.blocks[b], exit, nullptr, unused);
+            in[b] = entry;
+            if (!reached[b] || exit != out[b]) {
+                reached[b] = true;
+                out[b] = exit;
+                changed = true;
+            }
+        }
+    }
+
+    map<string, int> declared;
+    for (int i = 0; i < (int)program->instructions.size(); i++) {
+        collect_declarations(&program->instructions[i], i, declared);
+    }
+
+    int eliminated = 0;
+    for (int b = 0; b < count; b++) {
+        if (!reached[b]) continue;
+        block_transfer(program, graph.blocks[b], in[b], &declared, eliminated);
+    }
+    return eliminated;
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include "parser.h"
+
+using namespace std;
+
+// Global common-subexpression elimination over the cfg: an assignment whose sum
+// is already held by another variable on every path reaching it is rewritten
+// into a copy of that variable. Returns the number of sums eliminated.
+int eliminate_common_subexpressions(program_node* program);
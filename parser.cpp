@@ -21,13 +21,70 @@ string tokenKindToString(TokenKind kind) {
     }
 }
 
-void parser_init(vector<Token> tokens, parser* p) {
-    p->tokens = tokens;
+void parser_init(const vector<Token>& tokens, parser* p, const parser_limits& limits) {
+    p->tokens = &tokens;
     p->index = 0;
+    p->limits = limits;
+    p->errors.clear();
+    p->panic = false;
+    p->aborted = false;
+    p->nodes = 0;
+    p->memory = 0;
+    p->depth = 0;
+}
+
+// The current token; once the tokens run out this stays on END
+const Token& parser_token(parser* p) {
+    static const Token end = {TokenKind::END, ""};
+    if (p->index < p->tokens->size()) return (*p->tokens)[p->index];
+    return end;
+}
+
+void parser_advance(parser* p) {
+    const Token& token = parser_token(p);
+    if (token.kind == TokenKind::END) return;
+    p->memory += token.value.size();
+    p->index++;
+}
+
+// Records a diagnostic, only the first error of an instruction is kept
+void parser_error(parser* p, const string& message) {
+    if (p->panic || p->aborted) return;
+    p->panic = true;
+    p->errors.push_back("line " + to_string(parser_token(p).line) + ": " + message);
+    if (p->errors.size() >= p->limits.max_errors) {
+        p->errors.push_back("too many errors, giving up");
+        p->aborted = true;
+    }
+}
+
+static bool starts_instr(parser* p) {
+    switch (parser_token(p).kind) {
+        case TokenKind::IF:
+        case TokenKind::GOTO:
+        case TokenKind::OUTPUT:
+        case TokenKind::LABEL:
+        case TokenKind::END:
+            return true;
+        case TokenKind::IDENT:
+            return p->index + 1 < p->tokens->size() && (*p->tokens)[p->index + 1].kind == TokenKind::EQUAL;
+        default:
+            return false;
+    }
+}
+
+// Panic-mode recovery: skips to the next token that can start an instruction,
+// always consuming at least one token so that parse_program makes progress
+void parser_synchronize(parser* p, unsigned int start) {
+    if (p->index == start) parser_advance(p);
+    while (!starts_instr(p)) {
+        parser_advance(p);
+    }
+    p->panic = false;
 }
 
 void parse_term(parser* p, term_node* term) {
-    Token token = p->tokens[p->index];
+    Token token = parser_token(p);
     if (token.kind == TokenKind::INPUT){
         term->kind = TERM_INPUT;
     }
@@ -40,11 +97,11 @@ void parse_term(parser* p, term_node* term) {
         term->value = token.value;
     } 
     else{
-        cout<<"Expected int, input or ident but found "<<show_token_kind(token.kind)<<"\n";
+        parser_error(p, "Expected int, input or ident but found " + show_token_kind(token.kind));
         return;
     }
 
-    p->index++;
+    parser_advance(p);
 }
 
 void parse_expr(parser* p, expr_node* expr) {
@@ -52,10 +109,11 @@ void parse_expr(parser* p, expr_node* expr) {
     term_node lhs, rhs;
     
     parse_term(p, &lhs);
-    token = p->tokens[p->index];
+    if (p->panic) return;
+    token = parser_token(p);
 
     if(token.kind == TokenKind::PLUS){
-        p->index++;
+        parser_advance(p);
         parse_term(p, &rhs);
         expr->kind = EXPR_PLUS;
         expr->node_type = term_binary_node{lhs, rhs};
@@ -71,15 +129,16 @@ void parse_rel(parser* p, rel_node* rel) {
     term_node lhs, rhs;
 
     parse_term(p, &lhs);
-    token = p->tokens[p->index];
+    if (p->panic) return;
+    token = parser_token(p);
     if(token.kind == TokenKind::LESS_THAN){
-        p->index++;
+        parser_advance(p);
         parse_term(p, &rhs);
         rel->kind = REL_LESS_THAN;
         rel->less_than = term_binary_node{lhs, rhs};
     } 
     else{
-        cout<<"Expected rel (<) found "<<show_token_kind(token.kind)<<"\n";
+        parser_error(p, "Expected rel (<) found " + show_token_kind(token.kind));
         return;
     }
 }
@@ -89,7 +148,7 @@ void parse_if(parser* p, instr_node* instr) {
 
     instr->set_kind(INSTR_IF);
     instr->node_type = if_node();
-    p->index++;
+    parser_advance(p);
 
     auto if_instr = get_if<if_node>(&instr->node_type);
     
@@ -99,22 +158,30 @@ void parse_if(parser* p, instr_node* instr) {
     }
 
     parse_rel(p, &if_instr->rel);
-    token = p->tokens[p->index];
+    if (p->panic) return;
+    token = parser_token(p);
     if(token.kind != TokenKind::THEN){
-        cout<<"Expected 'then' but found "<<show_token_kind(token.kind)<<"\n";
+        parser_error(p, "Expected 'then' but found " + show_token_kind(token.kind));
         return;
     }
-    p->index++;
+    parser_advance(p);
 
-    if_instr->instr = new instr_node();
-    parse_instr(p, if_instr->instr);
+    if (p->depth >= p->limits.max_depth) {
+        parser_error(p, "if instructions nested too deeply");
+        p->aborted = true;
+        return;
+    }
+    p->depth++;
+    if_instr->instr = make_unique<instr_node>();
+    parse_instr(p, if_instr->instr.get());
+    p->depth--;
 }
 
 
 
 
 void parse_assign(parser* p, instr_node* instr) {
-    Token token = p->tokens[p->index];
+    Token token = parser_token(p);
 
     auto assign_ptr = get_if<assign_node>(&instr->node_type);
     if(assign_ptr)
@@ -125,28 +192,29 @@ void parse_assign(parser* p, instr_node* instr) {
     }
 
     instr->set_kind(INSTR_ASSIGN);
-    p->index++;
+    parser_advance(p);
 
-    if (p->tokens[p->index].kind != TokenKind::EQUAL) {
-        cout << "Expected equal but found " << show_token_kind(p->tokens[p->index].kind) << endl;
+    if (parser_token(p).kind != TokenKind::EQUAL) {
+        parser_error(p, "Expected equal but found " + show_token_kind(parser_token(p).kind));
         return;
     }
 
-    p->index++;
+    parser_advance(p);
     parse_expr(p, &get<assign_node>(instr->node_type).expr);
 }
 
 void parse_goto(parser* p, instr_node* instr) {
     instr->set_kind(INSTR_GOTO);
     instr->node_type = goto_node();
-    p->index++;
+    parser_advance(p);
     
-    Token token = p->tokens[p->index];
+    Token token = parser_token(p);
     
     if(token.kind != TokenKind::LABEL){
-        cout<<"Expected label found "<<show_token_kind(token.kind);
+        parser_error(p, "Expected label found " + show_token_kind(token.kind));
+        return;
     }
-    p->index++;
+    parser_advance(p);
 
     auto goto_ptr = get_if<goto_node>(&instr->node_type);
     if(goto_ptr){
@@ -161,7 +229,7 @@ void parse_goto(parser* p, instr_node* instr) {
 void parse_output(parser* p, instr_node* instr){
     instr->set_kind(INSTR_OUTPUT);
     instr->node_type = output_node();
-    p->index++;
+    parser_advance(p);
 
     term_node lhs;
     parse_term(p, &lhs);
@@ -177,7 +245,7 @@ void parse_output(parser* p, instr_node* instr){
 void parse_label(parser* p, instr_node* instr){
     instr->set_kind(INSTR_LABEL);
     instr->node_type = label_node();
-    Token token = p->tokens[p->index];
+    Token token = parser_token(p);
 
     auto label_ptr = get_if<label_node>(&instr->node_type);
     if(label_ptr){
@@ -186,13 +254,22 @@ void parse_label(parser* p, instr_node* instr){
     else{
         cerr << "Error: node_type does not currently hold an label_node\n";
     }  
-    p->index++;
+    parser_advance(p);
 }
 
 
 
 void parse_instr(parser* p, instr_node* instr){
-    Token token = p->tokens[p->index];
+    Token token = parser_token(p);
+    instr->line = token.line;
+
+    p->nodes++;
+    p->memory += sizeof(instr_node);
+    if (p->nodes > p->limits.max_nodes || p->memory > p->limits.max_memory) {
+        parser_error(p, "program too large");
+        p->aborted = true;
+        return;
+    }
 
     switch (token.kind) {
         case TokenKind::IDENT:
@@ -211,19 +288,25 @@ void parse_instr(parser* p, instr_node* instr){
             parse_label(p, instr);
             break;
         default:
-            cerr << "Unexpected token " << show_token_kind(token.kind);
+            parser_error(p, "Unexpected token " + show_token_kind(token.kind));
             break;
     }    
 }
 
-void parse_program(struct parser* p, struct program_node* program) {
-    struct Token token;
-    do{
+// Parses every instruction up to END, recovering after each error so that all
+// diagnostics end up in p->errors. Returns false if there were any.
+bool parse_program(struct parser* p, struct program_node* program) {
+    while (parser_token(p).kind != TokenKind::END && !p->aborted) {
+        unsigned int start = p->index;
         struct instr_node instr;
         parse_instr(p, &instr);
-        program->instructions.push_back(instr);
-        token = p->tokens[p->index];
-    }while(token.kind != TokenKind::END);
+        if (p->panic) {
+            parser_synchronize(p, start);
+            continue;
+        }
+        program->instructions.push_back(move(instr));
+    }
+    return p->errors.empty();
 }
 
 void print_program(struct program_node* program) {
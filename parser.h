@@ -6,34 +6,11 @@
 #include <variant>
 #include <memory>
 
+#include "kinds.h"
 #include "lexer.h"
 
 using namespace std;
 
-enum term_kind { 
-    TERM_INPUT, 
-    TERM_INT, 
-    TERM_IDENT 
-};
-
-enum instr_kind { 
-    INSTR_ASSIGN, 
-    INSTR_IF, 
-    INSTR_GOTO, 
-    INSTR_OUTPUT, 
-    INSTR_LABEL 
-};
-
-enum expr_kind { 
-    EXPR_TERM, 
-    EXPR_PLUS 
-};
-
-enum rel_kind {
-    REL_LESS_THAN 
-};
-
-
 struct instr_node; // forward declaration of instr_node
 
 struct term_node {
@@ -68,8 +45,8 @@ struct assign_node {
 
 struct if_node {
     rel_node rel;
-    instr_node* instr; // needed to point to the goto instruction present in the if instruction
-    // if_node.instr will point to a dynamically parsed goto instruction
+    unique_ptr<instr_node> instr; // needed to point to the goto instruction present in the if instruction
+    // if_node.instr owns the dynamically parsed goto instruction, so the body is freed with the if
 };
 
 struct output_node {
@@ -91,14 +68,17 @@ struct instr_node {
         goto_node,
         output_node,
         label_node> node_type;
+    int line; // source line of the first token, used to map profiles back to the source
     // instead of union, variant(type-safe union) is used, which automatically handles construction, destruction and type checks unline unions or struct
 
     instr_node() : // default constructor
         kind(INSTR_ASSIGN), 
-        node_type(assign_node()) {}
+        node_type(assign_node()),
+        line(0) {}
     
     instr_node(instr_kind k) : // parameterized constructor
-        kind(k) {
+        kind(k),
+        line(0) {
         switch (k) {
             case INSTR_ASSIGN: new(&node_type) assign_node(); break;
             case INSTR_IF: new(&node_type) if_node(); break;
@@ -118,12 +98,30 @@ struct program_node {
     vector<instr_node> instructions;
 };
 
-struct parser {
-    vector<Token> tokens;
-    unsigned int index;
+struct parser_limits {
+    unsigned int max_errors = 100;      // stop after this many diagnostics
+    size_t max_nodes = 1000000;         // instr_nodes, if bodies included
+    size_t max_memory = 256 << 20;      // approximate bytes held by the AST
+    unsigned int max_depth = 256;       // nesting of if bodies
 };
 
-void parser_init(vector<Token> tokens, parser* p);
+struct parser {
+    const vector<Token>* tokens;   // borrowed, must outlive the parse
+    unsigned int index;
+    parser_limits limits;
+    vector<string> errors;  // diagnostics of the whole program, "line N: message"
+    bool panic;             // an error was reported in the current instruction, the rest of it is skipped
+    bool aborted;           // a limit was hit, parsing stopped
+    size_t nodes;
+    size_t memory;
+    unsigned int depth;
+};
+
+void parser_init(const vector<Token>& tokens, parser* p, const parser_limits& limits = parser_limits());
+const Token& parser_token(parser* p);
+void parser_advance(parser* p);
+void parser_error(parser* p, const string& message);
+void parser_synchronize(parser* p, unsigned int start);
 void parse_term(parser* p, term_node* term);
 void parse_expr(parser* p, expr_node* expr);
 void parse_rel(parser* p, rel_node* rel);
@@ -133,5 +131,5 @@ void parse_goto(parser* p, instr_node* instr);
 void parse_output(parser* p, instr_node* instr);
 void parse_label(parser* p, instr_node* instr);
 void parse_instr(parser* p, instr_node* instr);
-void parse_program(parser* p, program_node* program);
+bool parse_program(parser* p, program_node* program);
 void print_program(struct program_node* program);
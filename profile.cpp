@@ -0,0 +1,60 @@
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include "profile.h"
+
+using namespace std;
+
+static void read_qwords(const string& bytes, size_t& offset, vector<uint64_t>& values, uint64_t count) {
+    values.resize(count);
+    if (count == 0) return;
+    memcpy(values.data(), bytes.data() + offset, count * sizeof(uint64_t));
+    offset += count * sizeof(uint64_t);
+}
+
+bool parse_profile(const string& bytes, profile_data* profile, string& error) {
+    uint64_t header[3];
+    if (bytes.size() < sizeof(header)) {
+        error = "Not a profile";
+        return false;
+    }
+    memcpy(header, bytes.data(), sizeof(header));
+    if (header[0] != PROFILE_MAGIC) {
+        error = "Not a profile";
+        return false;
+    }
+
+    uint64_t remaining = (bytes.size() - sizeof(header)) / sizeof(uint64_t);
+    if (header[1] > remaining || header[2] > remaining || header[1] * 2 + header[2] > remaining) {
+        error = "Truncated profile";
+        return false;
+    }
+
+    size_t offset = sizeof(header);
+    read_qwords(bytes, offset, profile->blocks, header[1]);
+    read_qwords(bytes, offset, profile->ifs, header[2]);
+    read_qwords(bytes, offset, profile->cycles, header[1]);
+    return true;
+}
+
+bool read_profile_file(const string& path, string& bytes, string& error) {
+    ifstream in(path, ios::binary);
+    if (!in) {
+        error = "Cannot open profile " + path;
+        return false;
+    }
+    ostringstream ss;
+    ss << in.rdbuf();
+    bytes = ss.str();
+    return true;
+}
+
+bool load_profile(const string& path, profile_data* profile, string& error) {
+    string bytes;
+    if (!read_profile_file(path, bytes, error)) return false;
+    if (!parse_profile(bytes, profile, error)) {
+        error += ": " + path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// A profile is written by programs compiled with --profile as raw little-endian qwords:
+// magic, block count, if count, then the block entry counts, the taken counts of
+// every if (numbered like instr_asm numbers them) and the cycles spent in each block.
+#define PROFILE_MAGIC 0x50524f46
+#define DEFAULT_PROFILE_PATH "profile.out"
+
+struct profile_data {
+    vector<uint64_t> blocks;
+    vector<uint64_t> ifs;
+    vector<uint64_t> cycles;
+};
+
+bool load_profile(const string& path, profile_data* profile, string& error);
+// The same from the raw bytes of a profile, e.g. sent to compile_server
+bool parse_profile(const string& bytes, profile_data* profile, string& error);
+bool read_profile_file(const string& path, string& bytes, string& error);
@@ -0,0 +1,82 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "cfg.h"
+#include "compile.h"
+#include "parser.h"
+#include "profile.h"
+
+using namespace std;
+
+// Maps a profile written by a program built with ./main --profile back to the
+// source it was compiled from: one row per basic block, then one per if.
+
+string block_name(program_node* program, const basic_block& block) {
+    instr_node& first = program->instructions[block.first];
+    if (first.kind == INSTR_LABEL) return ":" + get<label_node>(first.node_type).label;
+    return "";
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2 || argc > 3) {
+        cerr << "usage: " << argv[0] << " source [" << DEFAULT_PROFILE_PATH << "]\n";
+        return 1;
+    }
+
+    ifstream file(argv[1]);
+    if (!file) {
+        cerr << "Cannot open " << argv[1] << endl;
+        return 1;
+    }
+    ostringstream ss;
+    ss << file.rdbuf();
+
+    vector<Token> tokens;
+    lex_source(ss.str(), tokens);
+    struct parser p;
+    struct program_node program;
+    parser_init(tokens, &p);
+    if (!parse_program(&p, &program)) {
+        for (const auto& error : p.errors) {
+            cerr << error << endl;
+        }
+        return 1;
+    }
+
+    cfg graph;
+    build_cfg(&program, &graph);
+
+    profile_data profile;
+    string error;
+    if (!load_profile(argc == 3 ? argv[2] : DEFAULT_PROFILE_PATH, &profile, error)) {
+        cerr << error << endl;
+        return 1;
+    }
+    if (profile.blocks.size() != graph.blocks.size() || profile.ifs.size() != graph.ifs.size()) {
+        cerr << "Profile does not match " << argv[1] << ": " << profile.blocks.size() << " blocks and "
+             << profile.ifs.size() << " ifs, expected " << graph.blocks.size() << " and " << graph.ifs.size() << endl;
+        return 1;
+    }
+
+    uint64_t total_cycles = 0;
+    for (uint64_t c : profile.cycles) total_cycles += c;
+
+    printf("%-6s %-7s %-16s %14s %16s %7s\n", "block", "lines", "label", "count", "cycles", "cycles%");
+    for (size_t b = 0; b < graph.blocks.size(); b++) {
+        const basic_block& block = graph.blocks[b];
+        string lines = to_string(program.instructions[block.first].line) + "-"
+            + to_string(program.instructions[block.last - 1].line);
+        double share = total_cycles ? 100.0 * profile.cycles[b] / total_cycles : 0.0;
+        printf("%-6zu %-7s %-16s %14llu %16llu %6.1f%%\n", b, lines.c_str(), block_name(&program, block).c_str(),
+               (unsigned long long)profile.blocks[b], (unsigned long long)profile.cycles[b], share);
+    }
+
+    printf("\n%-6s %-7s %14s\n", "if", "line", "taken");
+    for (size_t i = 0; i < graph.ifs.size(); i++) {
+        printf("%-6zu %-7d %14llu\n", i, graph.ifs[i]->line, (unsigned long long)profile.ifs[i]);
+    }
+    return 0;
+}
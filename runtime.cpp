@@ -0,0 +1,178 @@
+#include <chrono>
+#include <map>
+#include <stdexcept>
+#include "assembler.h"
+#include "jit.h"
+#include "runtime.h"
+
+using namespace std;
+
+// Reads a line and parses its leading digits, like parse_uint in utils.inc
+int64_t rt_input(rt_io* io) {
+    uint64_t value = 0;
+    int c = fgetc(io->in);
+    while (c >= '0' && c <= '9') {
+        value = value * 10 + (c - '0');
+        c = fgetc(io->in);
+    }
+    while (c != '\n' && c != EOF) c = fgetc(io->in);
+    return value;
+}
+
+void rt_output(rt_io* io, int64_t value) {
+    fprintf(io->out, "%llu\n", (unsigned long long)value);
+}
+
+static rt_term lower_term(const term_node& term, const vector<string>& variables) {
+    rt_term lowered = {term.kind, 0, -1};
+    switch (term.kind) {
+    case TERM_INPUT:
+        break;
+    case TERM_INT:
+        lowered.value = stoull(term.value);
+        break;
+    case TERM_IDENT:
+        for (int i = 0; i < (int)variables.size(); i++) {
+            if (variables[i] == term.value) lowered.var = i;
+        }
+        break;
+    }
+    return lowered;
+}
+
+static rt_instr lower_instr(instr_node* instr, const vector<string>& variables,
+                            const map<string, int>& labels, rt_program* lowered) {
+    rt_instr result = {instr->kind, EXPR_TERM, -1, {TERM_INT, 0, -1}, {TERM_INT, 0, -1}, -1, -1};
+    switch (instr->kind) {
+    case INSTR_ASSIGN: {
+        auto& a = get<assign_node>(instr->node_type);
+        result.expr = a.expr.kind;
+        if (a.expr.kind == EXPR_PLUS) {
+            auto& bin = get<term_binary_node>(a.expr.node_type);
+            result.lhs = lower_term(bin.lhs, variables);
+            result.rhs = lower_term(bin.rhs, variables);
+        } else {
+            result.lhs = lower_term(get<term_node>(a.expr.node_type), variables);
+        }
+        term_node target = {TERM_IDENT, a.ident};
+        result.var = lower_term(target, variables).var;
+        break;
+    }
+    case INSTR_IF: {
+        auto& if_ = get<if_node>(instr->node_type);
+        if (if_.instr->kind == INSTR_LABEL)
+            throw runtime_error("Labels inside if bodies are not supported");
+        result.lhs = lower_term(if_.rel.less_than.lhs, variables);
+        result.rhs = lower_term(if_.rel.less_than.rhs, variables);
+        rt_instr body = lower_instr(if_.instr.get(), variables, labels, lowered);
+        result.body = lowered->bodies.size();
+        lowered->bodies.push_back(body);
+        break;
+    }
+    case INSTR_GOTO: {
+        auto& g = get<goto_node>(instr->node_type);
+        auto target = labels.find(g.label);
+        if (target == labels.end())
+            throw runtime_error("Label not defined: " + g.label);
+        result.target = target->second;
+        break;
+    }
+    case INSTR_OUTPUT:
+        result.lhs = lower_term(get<output_node>(instr->node_type).term, variables);
+        break;
+    case INSTR_LABEL:
+        break;
+    }
+    return result;
+}
+
+void lower_program(program_node* program, rt_program* lowered) {
+    vector<string> variables;
+    map<string, int> labels;
+
+    for (int i = 0; i < (int)program->instructions.size(); i++) {
+        instr_node* instr = &program->instructions[i];
+        instr_declare_variables(instr, variables);
+        if (instr->kind == INSTR_LABEL)
+            labels.emplace(get<label_node>(instr->node_type).label, i);
+    }
+
+    lowered->instrs.clear();
+    lowered->bodies.clear();
+    lowered->var_count = variables.size();
+    for (auto& instr : program->instructions) {
+        lowered->instrs.push_back(lower_instr(&instr, variables, labels, lowered));
+    }
+}
+
+static int64_t eval_term(const rt_term& term, int64_t* vars, rt_io* io) {
+    switch (term.kind) {
+    case TERM_INPUT: return rt_input(io);
+    case TERM_INT: return term.value;
+    case TERM_IDENT: return vars[term.var];
+    }
+    return 0;
+}
+
+// Executes one instruction, returns the goto target or -1 to fall through
+static int interpret_instr(const rt_program& program, const rt_instr& instr, int64_t* vars, rt_io* io) {
+    switch (instr.kind) {
+    case INSTR_ASSIGN: {
+        int64_t value = eval_term(instr.lhs, vars, io);
+        if (instr.expr == EXPR_PLUS)
+            value = (int64_t)((uint64_t)value + (uint64_t)eval_term(instr.rhs, vars, io));
+        vars[instr.var] = value;
+        break;
+    }
+    case INSTR_IF: {
+        int64_t lhs = eval_term(instr.lhs, vars, io);
+        if (lhs < eval_term(instr.rhs, vars, io))
+            return interpret_instr(program, program.bodies[instr.body], vars, io);
+        break;
+    }
+    case INSTR_GOTO:
+        return instr.target;
+    case INSTR_OUTPUT:
+        rt_output(io, eval_term(instr.lhs, vars, io));
+        break;
+    case INSTR_LABEL:
+        break;
+    }
+    return -1;
+}
+
+void run_program(const rt_program& program, const rt_options& options, rt_io* io, rt_stats* stats) {
+    int count = program.instrs.size();
+    vector<int64_t> vars(program.var_count + 1, 0);
+    vector<unsigned int> hits(count, 0);
+    vector<jit_region> regions(count, jit_region{nullptr, nullptr, 0});
+    *stats = rt_stats{0, 0, 0, 0.0};
+
+    int pc = 0;
+    while (pc < count) {
+        if (regions[pc].entry) {
+            stats->native_entries++;
+            pc = regions[pc].entry(vars.data(), io);
+            continue;
+        }
+
+        const rt_instr& instr = program.instrs[pc];
+        if (instr.kind == INSTR_LABEL && options.tier_threshold && ++hits[pc] == options.tier_threshold) {
+            auto start = chrono::steady_clock::now();
+            bool compiled = jit_compile(program, pc, &regions[pc]);
+            stats->compile_seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            if (compiled) {
+                stats->regions++;
+                continue;
+            }
+        }
+
+        stats->interpreted++;
+        int target = interpret_instr(program, instr, vars.data(), io);
+        pc = target >= 0 ? target : pc + 1;
+    }
+
+    for (auto& region : regions) {
+        jit_free(&region);
+    }
+}
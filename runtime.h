@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "parser.h"
+
+using namespace std;
+
+// Tiered execution: program_node is lowered to rt_program and interpreted; once a
+// label has been reached tier_threshold times, the code from that label to the end
+// of the program is compiled to x86-64 (jit.h) and entered the next time the label
+// is reached, i.e. at the next loop back-edge.
+
+struct rt_term {
+    term_kind kind;
+    int64_t value;      // TERM_INT
+    int var;            // TERM_IDENT, slot in the variable array
+};
+
+// instr_node with variables resolved to slots and gotos to instruction indices
+struct rt_instr {
+    instr_kind kind;
+    expr_kind expr;     // INSTR_ASSIGN
+    int var;            // INSTR_ASSIGN target slot
+    rt_term lhs;        // expression, rel or output operand
+    rt_term rhs;
+    int target;         // INSTR_GOTO, index in rt_program::instrs
+    int body;           // INSTR_IF, index in rt_program::bodies
+};
+
+struct rt_program {
+    vector<rt_instr> instrs;
+    vector<rt_instr> bodies;
+    int var_count;
+};
+
+struct rt_options {
+    unsigned int tier_threshold = 1000;     // label hits before its region is compiled, 0 never compiles
+};
+
+struct rt_stats {
+    uint64_t interpreted;       // instructions executed by the interpreter
+    uint64_t native_entries;    // times execution switched to compiled code
+    int regions;                // labels compiled
+    double compile_seconds;
+};
+
+// Native code and the interpreter share these to read input and write output
+struct rt_io {
+    FILE* in;
+    FILE* out;
+};
+
+int64_t rt_input(rt_io* io);
+void rt_output(rt_io* io, int64_t value);
+
+// Throws runtime_error for programs that cannot be lowered
+void lower_program(program_node* program, rt_program* lowered);
+void run_program(const rt_program& program, const rt_options& options, rt_io* io, rt_stats* stats);
@@ -0,0 +1,233 @@
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "compile.h"
+#include "profile.h"
+#include "socket_io.h"
+
+using namespace std;
+
+// Compile daemon: accepts one request per connection on a Unix socket. A request is
+//
+//     options N\n             followed by N lines, each a ./main option
+//     <profile bytes>         only with --profile-bytes=SIZE, the contents of a profile
+//     <source>                up to the end of the stream
+//
+// --profile-bytes=SIZE stands in for --profile-use=PATH, the server never opens
+// client paths. Limits only apply if they are below the server's own. The answer is
+// "ok SIZE\n" followed by SIZE bytes of diagnostics (what ./main prints to stderr)
+// and the assembly, or "error\n" followed by the message.
+
+struct server_config {
+    int timeout = 10;                   // seconds a client may stall a read or write
+    size_t max_source = 16 << 20;       // larger sources are rejected
+    compile_options options;
+};
+
+struct work_queue {
+    const server_config* config;
+    queue<int> clients;
+    mutex lock;
+    condition_variable ready;
+};
+
+// Per-worker state kept across requests so buffers keep their capacity
+struct worker_state {
+    string source;
+    vector<Token> tokens;
+};
+
+void reply_error(int fd, const string& message) {
+    string reply = "error\n" + message + "\n";
+    write_all(fd, reply.c_str(), reply.size());
+    close(fd);
+}
+
+static bool read_line(const string& request, size_t* pos, string* line) {
+    size_t newline = request.find('\n', *pos);
+    if (newline == string::npos) return false;
+    *line = request.substr(*pos, newline - *pos);
+    *pos = newline + 1;
+    return true;
+}
+
+// Applies the request header on top of the server's options and strips it (and the
+// profile) from state->source, leaving the program text
+bool parse_request(worker_state* state, const server_config* config, compile_options* options,
+                   bool* stats, profile_data* profile, string& error) {
+    string& request = state->source;
+    size_t pos = 0;
+    string line;
+    if (!read_line(request, &pos, &line) || line.compare(0, 8, "options ") != 0) {
+        error = "missing options header";
+        return false;
+    }
+
+    unsigned long count = strtoul(line.c_str() + 8, nullptr, 10);
+    size_t profile_size = 0;
+    bool has_profile = false;
+    *options = config->options;
+    for (unsigned long i = 0; i < count; i++) {
+        if (!read_line(request, &pos, &line)) {
+            error = "truncated options header";
+            return false;
+        }
+        if (line.compare(0, 16, "--profile-bytes=") == 0) {
+            profile_size = strtoull(line.c_str() + 16, nullptr, 10);
+            has_profile = true;
+        } else if (!parse_compile_option(line, options, stats, error)) {
+            return false;
+        }
+    }
+    options->limits.max_errors = min(options->limits.max_errors, config->options.limits.max_errors);
+    options->limits.max_nodes = min(options->limits.max_nodes, config->options.limits.max_nodes);
+    options->limits.max_memory = min(options->limits.max_memory, config->options.limits.max_memory);
+
+    if (has_profile) {
+        if (profile_size > request.size() - pos) {
+            error = "truncated profile";
+            return false;
+        }
+        if (!parse_profile(request.substr(pos, profile_size), profile, error)) return false;
+        options->codegen.layout_profile = profile;
+        pos += profile_size;
+    }
+    request.erase(0, pos);
+    return true;
+}
+
+void handle_client(int fd, const server_config* config, worker_state* state) {
+    state->source.clear();
+    set_timeout(fd, config->timeout);
+    if (!read_all(fd, state->source, config->max_source)) {
+        reply_error(fd, "cannot read source (timed out?)");
+        return;
+    }
+    if (state->source.size() > config->max_source) {
+        reply_error(fd, "source larger than " + to_string(config->max_source) + " bytes");
+        return;
+    }
+
+    compile_options options;
+    bool stats = false;
+    profile_data profile;
+    string error;
+    if (!parse_request(state, config, &options, &stats, &profile, error)) {
+        reply_error(fd, error);
+        return;
+    }
+
+    char* buffer = nullptr;
+    size_t size = 0;
+    FILE* out = open_memstream(&buffer, &size);
+    if (!out) {
+        reply_error(fd, "out of memory");
+        return;
+    }
+
+    compile_stats result;
+    bool ok = compile_source(state->source, options, state->tokens, out, error, &result);
+    fclose(out);
+
+    if (!ok) {
+        free(buffer);
+        reply_error(fd, error);
+        return;
+    }
+    string diagnostics;
+    if (stats && options.cse) diagnostics = "cse: " + to_string(result.cse_eliminated) + " expressions eliminated\n";
+    string header = "ok " + to_string(diagnostics.size()) + "\n" + diagnostics;
+    write_all(fd, header.data(), header.size());
+    write_all(fd, buffer, size);
+    free(buffer);
+    close(fd);
+}
+
+void worker_loop(work_queue* q) {
+    worker_state state;
+    while (true) {
+        int fd;
+        {
+            unique_lock<mutex> guard(q->lock);
+            q->ready.wait(guard, [q] { return !q->clients.empty(); });
+            fd = q->clients.front();
+            q->clients.pop();
+        }
+        handle_client(fd, q->config, &state);
+    }
+}
+
+int main(int argc, char** argv) {
+    string path = DEFAULT_SOCKET_PATH;
+    server_config config;
+    unsigned int threads = thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            path = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+            if (threads == 0) threads = 1;
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            config.timeout = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            config.max_source = strtoull(argv[++i], nullptr, 10);
+        } else if (strncmp(argv[i], "--max-errors=", 13) == 0) {
+            config.options.limits.max_errors = strtoul(argv[i] + 13, nullptr, 10);
+        } else if (strncmp(argv[i], "--max-nodes=", 12) == 0) {
+            config.options.limits.max_nodes = strtoull(argv[i] + 12, nullptr, 10);
+        } else if (strncmp(argv[i], "--max-memory=", 13) == 0) {
+            config.options.limits.max_memory = strtoull(argv[i] + 13, nullptr, 10);
+        } else {
+            cerr << "usage: " << argv[0] << " [-s socket_path] [-j threads] [-t timeout_seconds] [-m max_source_bytes]"
+                 << " [--max-errors=N] [--max-nodes=N] [--max-memory=BYTES]\n";
+            return 1;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    int listen_fd = listen_unix(path);
+    if (listen_fd < 0) {
+        cerr << "Cannot listen on " << path << ": " << strerror(errno) << endl;
+        return 1;
+    }
+    cerr << "Listening on " << path << " with " << threads << " workers\n";
+
+    work_queue q;
+    q.config = &config;
+    for (unsigned int i = 0; i < threads; i++) {
+        thread(worker_loop, &q).detach();
+    }
+
+    while (true) {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            cerr << "accept failed: " << strerror(errno) << endl;
+            break;
+        }
+        {
+            lock_guard<mutex> guard(q.lock);
+            q.clients.push(fd);
+        }
+        q.ready.notify_one();
+    }
+
+    close(listen_fd);
+    unlink(path.c_str());
+    return 1;
+}
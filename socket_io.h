@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+#define DEFAULT_SOCKET_PATH "/tmp/compile_server.sock"
+
+// Reads from fd until EOF, appending everything to buffer. Stops early once the
+// buffer holds more than max_size bytes; returns false on errors and timeouts.
+bool read_all(int fd, string& buffer, size_t max_size = SIZE_MAX);
+// Writes the whole buffer to fd, retrying on short writes.
+bool write_all(int fd, const char* data, size_t size);
+
+// Makes reads and writes on fd fail after seconds without progress
+bool set_timeout(int fd, int seconds);
+
+int listen_unix(const string& path);
+int connect_unix(const string& path);
@@ -0,0 +1,89 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "compile.h"
+#include "parser.h"
+#include "runtime.h"
+
+using namespace std;
+
+// Runs a program directly instead of emitting assembly: the program is read from
+// the given file, its input from stdin. Cold code is interpreted and hot labels
+// are compiled to native code, see runtime.h.
+
+int main(int argc, char** argv) {
+    auto start = chrono::steady_clock::now();
+    rt_options options;
+    bool stats = false;
+    const char* path = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--threshold=", 12) == 0) {
+            options.tier_threshold = strtoul(argv[i] + 12, nullptr, 10);
+        } else if (strcmp(argv[i], "--interpret") == 0) {
+            options.tier_threshold = 0;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            stats = true;
+        } else if (!path && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            path = nullptr;
+            break;
+        }
+    }
+    if (!path) {
+        cerr << "usage: " << argv[0] << " [--threshold=N | --interpret] [--stats] source < input\n";
+        return 1;
+    }
+
+    ifstream file(path);
+    if (!file) {
+        cerr << "Cannot open " << path << endl;
+        return 1;
+    }
+    ostringstream ss;
+    ss << file.rdbuf();
+
+    vector<Token> tokens;
+    lex_source(ss.str(), tokens);
+    struct parser p;
+    struct program_node program;
+    parser_init(tokens, &p);
+    if (!parse_program(&p, &program)) {
+        for (const auto& error : p.errors) {
+            cerr << error << endl;
+        }
+        return 1;
+    }
+
+    rt_program lowered;
+    try {
+        lower_program(&program, &lowered);
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    auto ready = chrono::steady_clock::now();
+    rt_io io = {stdin, stdout};
+    rt_stats result;
+    run_program(lowered, options, &io, &result);
+    fflush(stdout);
+    auto done = chrono::steady_clock::now();
+
+    if (stats) {
+        cerr << "startup: " << chrono::duration<double, micro>(ready - start).count() << " us\n";
+        cerr << "run: " << chrono::duration<double, milli>(done - ready).count() << " ms\n";
+        cerr << "interpreted instructions: " << result.interpreted << "\n";
+        cerr << "compiled regions: " << result.regions << " in "
+             << result.compile_seconds * 1e6 << " us\n";
+        cerr << "native entries: " << result.native_entries << "\n";
+    }
+    return 0;
+}